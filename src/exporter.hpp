@@ -0,0 +1,234 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// CSV text writer with one large output buffer. Numbers are formatted with
+// std::to_chars (shortest round-trip form) and the buffer is only handed to
+// the FILE* when full or on flush(), so there is no per-line flush.
+class CsvWriter {
+private:
+    std::FILE* out;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    char* reserve(size_t n) {
+        if (used + n > buffer.size()) flush_buffer();
+        return buffer.data() + used;
+    }
+
+    void flush_buffer() {
+        if (used > 0) {
+            std::fwrite(buffer.data(), 1, used, out);
+            used = 0;
+        }
+    }
+
+public:
+    explicit CsvWriter(std::FILE* file, size_t capacity = 1 << 20)
+        : out(file), buffer(capacity) {}
+
+    ~CsvWriter() { flush(); }
+
+    CsvWriter(const CsvWriter&) = delete;
+    CsvWriter& operator=(const CsvWriter&) = delete;
+
+    CsvWriter& text(const char* s, size_t n) {
+        if (n > buffer.size()) {
+            flush_buffer();
+            std::fwrite(s, 1, n, out);
+            return *this;
+        }
+        std::memcpy(reserve(n), s, n);
+        used += n;
+        return *this;
+    }
+
+    CsvWriter& text(const std::string& s) { return text(s.data(), s.size()); }
+
+    CsvWriter& text(const char* s) { return text(s, std::strlen(s)); }
+
+    CsvWriter& put(char c) {
+        *reserve(1) = c;
+        ++used;
+        return *this;
+    }
+
+    // Missing values are written as "null", as the JSON-backed output did
+    CsvWriter& number(double v) {
+        if (std::isnan(v)) return text("null", 4);
+        char* p = reserve(32);
+        used += std::to_chars(p, p + 32, v).ptr - p;
+        return *this;
+    }
+
+    CsvWriter& number(long long v) {
+        char* p = reserve(24);
+        used += std::to_chars(p, p + 24, v).ptr - p;
+        return *this;
+    }
+
+    CsvWriter& sep() { return put(','); }
+
+    CsvWriter& end_row() { return put('\n'); }
+
+    void flush() {
+        flush_buffer();
+        std::fflush(out);
+    }
+};
+
+// Binary columnar file: fixed-width 8-byte columns at 64-byte aligned offsets,
+// so a reader can mmap it and view each column in place, e.g.
+//   np.memmap(path, dtype="<f8", mode="r", offset=col.offset, shape=(rows,))
+//
+// Layout (little-endian):
+//   header     char magic[8] = "RITBARS1", uint64 rows, uint32 columns, uint32 reserved
+//   directory  per column: char name[32], uint32 type (0 = int64, 1 = float64),
+//              uint32 reserved, uint64 offset from file start
+//   data       rows * 8 bytes per column, in directory order
+class ColumnFileWriter {
+public:
+    enum ColumnType : std::uint32_t { Int64 = 0, Float64 = 1 };
+
+private:
+    struct Column {
+        std::string name;
+        ColumnType type;
+        const void* data;
+    };
+
+    static const size_t HEADER_SIZE = 24;
+    static const size_t ENTRY_SIZE = 48;
+    static const size_t NAME_SIZE = 32;
+    static const size_t ALIGNMENT = 64;
+
+    size_t rows;
+    std::vector<Column> columns;
+
+    static size_t align(size_t n) { return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; }
+
+public:
+    explicit ColumnFileWriter(size_t row_count) : rows(row_count) {}
+
+    // The vector must hold row_count values and outlive write()
+    template <typename T>
+    void add_column(const std::string& name, const std::vector<T>& values) {
+        static_assert(sizeof(T) == 8 && std::is_arithmetic<T>::value, "columns are 8-byte numbers");
+        columns.push_back({name.substr(0, NAME_SIZE - 1),
+                           std::is_floating_point<T>::value ? Float64 : Int64,
+                           values.data()});
+    }
+
+    bool write(const std::string& path) const {
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) {
+            std::cerr << "Failed to open " << path << " for writing" << std::endl;
+            return false;
+        }
+
+        std::vector<char> head(align(HEADER_SIZE + ENTRY_SIZE * columns.size()), 0);
+        std::uint64_t row_count = rows;
+        std::uint32_t column_count = static_cast<std::uint32_t>(columns.size());
+        std::memcpy(head.data(), "RITBARS1", 8);
+        std::memcpy(head.data() + 8, &row_count, 8);
+        std::memcpy(head.data() + 16, &column_count, 4);
+
+        std::uint64_t offset = head.size();
+        const size_t column_bytes = rows * 8;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            char* entry = head.data() + HEADER_SIZE + c * ENTRY_SIZE;
+            std::uint32_t type = columns[c].type;
+            std::memcpy(entry, columns[c].name.data(), columns[c].name.size());
+            std::memcpy(entry + NAME_SIZE, &type, 4);
+            std::memcpy(entry + NAME_SIZE + 8, &offset, 8);
+            offset += align(column_bytes);
+        }
+
+        static const char padding[ALIGNMENT] = {};
+        bool ok = std::fwrite(head.data(), 1, head.size(), f) == head.size();
+        for (const auto& column : columns) {
+            if (!ok) break;
+            ok = std::fwrite(column.data, 1, column_bytes, f) == column_bytes;
+            size_t pad = align(column_bytes) - column_bytes;
+            ok = ok && std::fwrite(padding, 1, pad, f) == pad;
+        }
+
+        if (std::fclose(f) != 0 || !ok) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+// Runs export jobs in order on a single worker thread so formatting and I/O
+// overlap with fetching. submit() blocks only once max_pending jobs are queued;
+// the destructor drains the queue.
+class BackgroundExporter {
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<std::function<void()>> jobs;
+    size_t max_pending;
+    bool stopping = false;
+    std::thread worker;
+
+    void run() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            space.notify_one();
+
+            try {
+                job();
+            } catch (const std::exception& e) {
+                std::cerr << "Export failed: " << e.what() << std::endl;
+            }
+        }
+    }
+
+public:
+    explicit BackgroundExporter(size_t max_pending_jobs = 64)
+        : max_pending(max_pending_jobs), worker([this] { run(); }) {}
+
+    ~BackgroundExporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        worker.join();
+    }
+
+    BackgroundExporter(const BackgroundExporter&) = delete;
+    BackgroundExporter& operator=(const BackgroundExporter&) = delete;
+
+    void submit(std::function<void()> job) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            space.wait(lock, [this] { return jobs.size() < max_pending; });
+            jobs.push_back(std::move(job));
+        }
+        ready.notify_one();
+    }
+};
@@ -1,18 +1,71 @@
 #include <array>
 #include <string>
+#include <vector>
 #include <iostream>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
 #include <chrono>
+#include <climits>
+#include <cmath>
 #include <ctime>
+#include <limits>
 #include <thread>
-#include <iomanip>
-#include <sstream>
+#include "time_utils.hpp"
+#include "exporter.hpp"
 
 using json = nlohmann::json;
 
 static const std::array<std::string,7> TICKERS = {"HXQ", "QQQ", "TQQQ", "SPLG", "SPY", "XEQT", "BTCUSD"};
 
+// Columnar OHLCV bars, one vector per field, sorted by timestamp
+struct Bars {
+    std::vector<long> timestamp;
+    std::vector<double> open;
+    std::vector<double> high;
+    std::vector<double> low;
+    std::vector<double> close;
+    std::vector<long long> volume;
+
+    size_t size() const { return timestamp.size(); }
+
+    void reserve(size_t n) {
+        timestamp.reserve(n);
+        open.reserve(n);
+        high.reserve(n);
+        low.reserve(n);
+        close.reserve(n);
+        volume.reserve(n);
+    }
+
+    void push_back(long ts, double o, double h, double l, double c, long long v) {
+        timestamp.push_back(ts);
+        open.push_back(o);
+        high.push_back(h);
+        low.push_back(l);
+        close.push_back(c);
+        volume.push_back(v);
+    }
+};
+
+// One regular trading session, as listed in the chart "meta" block
+struct TradingPeriod {
+    long start;
+    long end;
+    long gmtoffset;
+};
+
+// Exchange time zone and regular session boundaries for a ticker
+struct Session {
+    std::string timezone = "UTC";
+    long gmtoffset = 0;                   // seconds east of UTC
+    long open_sod = 0;                    // regular open, seconds into the local day
+    long close_sod = SECONDS_PER_DAY;     // regular close, seconds into the local day
+    std::vector<TradingPeriod> regular;   // per-day regular sessions, sorted by start
+};
+
+enum class Resolution { Daily, Weekly };
+
 // Helper functions
 static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
     userp->append((char*)contents, size * nmemb);
@@ -25,81 +78,95 @@ long get_timestamp(int days_ago) {
     return std::chrono::system_clock::to_time_t(time_ago);
 }
 
-std::string format_timestamp(time_t timestamp) {
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&timestamp), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+static double value_or_nan(const json& v) {
+    return v.is_null() ? std::numeric_limits<double>::quiet_NaN() : v.get<double>();
 }
 
-// Function 1: Get hourly data for last 7 days
-bool fetch_hourly_data(const std::string& ticker) {
-    CURL* curl = curl_easy_init();
-    if (!curl) return false;
+// Regular session covering ts, or nullptr if ts is outside every listed session
+static const TradingPeriod* find_period(const Session& session, long ts) {
+    auto it = std::upper_bound(session.regular.begin(), session.regular.end(), ts,
+                               [](long t, const TradingPeriod& p) { return t < p.start; });
+    if (it == session.regular.begin()) return nullptr;
+    --it;
+    return ts < it->end ? &*it : nullptr;
+}
 
-    std::string readBuffer;
-    long period2 = std::time(nullptr);
-    long period1 = get_timestamp(7); // Last 7 days for hourly data
+// UTC offset in effect at ts, so buckets follow DST changes inside the window
+static long utc_offset(const Session& session, long ts) {
+    const TradingPeriod* p = find_period(session, ts);
+    return p ? p->gmtoffset : session.gmtoffset;
+}
 
-    std::string url = "https://query1.finance.yahoo.com/v8/finance/chart/" + 
-                     ticker + "?period1=" + std::to_string(period1) + 
-                     "&period2=" + std::to_string(period2) + 
-                     "&interval=1h&includePrePost=true";
+static long local_day(const Session& session, long ts) {
+    return floor_div(ts + utc_offset(session, ts), SECONDS_PER_DAY);
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0");
+bool in_regular_session(const Session& session, long ts) {
+    if (!session.regular.empty()) {
+        return find_period(session, ts) != nullptr;
+    }
+    long sod = ts + session.gmtoffset - local_day(session, ts) * SECONDS_PER_DAY;
+    if (session.open_sod <= session.close_sod) {
+        return sod >= session.open_sod && sod < session.close_sod;
+    }
+    return sod >= session.open_sod || sod < session.close_sod;
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        std::cerr << "Curl failed: " << curl_easy_strerror(res) << std::endl;
-        curl_easy_cleanup(curl);
-        return false;
+static void append_periods(const json& days, std::vector<TradingPeriod>& out) {
+    if (!days.is_array()) return;
+    for (const auto& day : days) {
+        for (const auto& p : day) {
+            out.push_back({p.at("start").get<long>(), p.at("end").get<long>(), p.at("gmtoffset").get<long>()});
+        }
     }
+}
 
-    try {
-        json j = json::parse(readBuffer);
-        auto data = j["chart"]["result"][0];
-        
-        std::cout << "\nHOURLY DATA for " << ticker << " (Last 7 days)\n";
-        std::cout << "DateTime,Open,High,Low,Close,Volume\n";
-        
-        auto timestamps = data["timestamp"];
-        auto quotes = data["indicators"]["quote"][0];
-        
-        for (size_t i = 0; i < timestamps.size(); ++i) {
-            if (!quotes["close"][i].is_null()) {
-                std::cout << format_timestamp(timestamps[i]) << ","
-                         << quotes["open"][i] << ","
-                         << quotes["high"][i] << ","
-                         << quotes["low"][i] << ","
-                         << quotes["close"][i] << ","
-                         << quotes["volume"][i] << std::endl;
-            }
+static Session parse_session(const json& meta) {
+    Session session;
+    if (meta.contains("exchangeTimezoneName")) {
+        session.timezone = meta.at("exchangeTimezoneName").get<std::string>();
+    }
+    if (meta.contains("gmtoffset")) {
+        session.gmtoffset = meta.at("gmtoffset").get<long>();
+    }
+
+    if (meta.contains("currentTradingPeriod")) {
+        const auto& regular = meta.at("currentTradingPeriod").at("regular");
+        long offset = regular.at("gmtoffset").get<long>();
+        long start = regular.at("start").get<long>() + offset;
+        long end = regular.at("end").get<long>() + offset;
+        session.open_sod = start - floor_div(start, SECONDS_PER_DAY) * SECONDS_PER_DAY;
+        session.close_sod = end - floor_div(end, SECONDS_PER_DAY) * SECONDS_PER_DAY;
+        if (session.close_sod == session.open_sod) {
+            session.close_sod = session.open_sod + SECONDS_PER_DAY;  // 24h market
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing hourly data: " << e.what() << std::endl;
-        curl_easy_cleanup(curl);
-        return false;
     }
-    
-    curl_easy_cleanup(curl);
-    return true;
+
+    // With includePrePost=true the periods are split into pre/regular/post
+    if (meta.contains("tradingPeriods")) {
+        const auto& periods = meta.at("tradingPeriods");
+        append_periods(periods.is_object() && periods.contains("regular") ? periods.at("regular") : periods,
+                       session.regular);
+        std::sort(session.regular.begin(), session.regular.end(),
+                  [](const TradingPeriod& a, const TradingPeriod& b) { return a.start < b.start; });
+    }
+    return session;
 }
 
-// Function 2: Get daily data for last 30 days
-bool fetch_daily_data(const std::string& ticker) {
+// Download one chart and unpack it into columnar bars, dropping bars with no close
+bool fetch_chart(const std::string& ticker, long period1, long period2, const std::string& interval,
+                 bool include_pre_post, Bars& bars, Session& session) {
     CURL* curl = curl_easy_init();
     if (!curl) return false;
 
     std::string readBuffer;
-    long period2 = std::time(nullptr);
-    long period1 = get_timestamp(30); // Last 30 days
-
-    std::string url = "https://query1.finance.yahoo.com/v8/finance/chart/" + 
-                     ticker + "?period1=" + std::to_string(period1) + 
-                     "&period2=" + std::to_string(period2) + 
-                     "&interval=1d";
+    std::string url = "https://query1.finance.yahoo.com/v8/finance/chart/" +
+                     ticker + "?period1=" + std::to_string(period1) +
+                     "&period2=" + std::to_string(period2) +
+                     "&interval=" + interval;
+    if (include_pre_post) {
+        url += "&includePrePost=true";
+    }
 
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
@@ -115,98 +182,218 @@ bool fetch_daily_data(const std::string& ticker) {
 
     try {
         json j = json::parse(readBuffer);
-        auto data = j["chart"]["result"][0];
-        
-        std::cout << "\nDAILY DATA for " << ticker << " (Last 30 days)\n";
-        std::cout << "Date,Open,High,Low,Close,Volume\n";
-        
-        auto timestamps = data["timestamp"];
-        auto quotes = data["indicators"]["quote"][0];
-        
-        for (size_t i = 0; i < timestamps.size(); ++i) {
-            if (!quotes["close"][i].is_null()) {
-                std::cout << format_timestamp(timestamps[i]).substr(0, 10) << ","
-                         << quotes["open"][i] << ","
-                         << quotes["high"][i] << ","
-                         << quotes["low"][i] << ","
-                         << quotes["close"][i] << ","
-                         << quotes["volume"][i] << std::endl;
+        const auto& data = j.at("chart").at("result").at(0);
+        session = parse_session(data.at("meta"));
+
+        if (data.contains("timestamp")) {
+            const auto& timestamps = data.at("timestamp");
+            const auto& quotes = data.at("indicators").at("quote").at(0);
+            const auto& open = quotes.at("open");
+            const auto& high = quotes.at("high");
+            const auto& low = quotes.at("low");
+            const auto& close = quotes.at("close");
+            const auto& volume = quotes.at("volume");
+
+            bars.reserve(bars.size() + timestamps.size());
+            for (size_t i = 0; i < timestamps.size(); ++i) {
+                if (close.at(i).is_null()) continue;
+                bars.push_back(timestamps.at(i).get<long>(),
+                               value_or_nan(open.at(i)),
+                               value_or_nan(high.at(i)),
+                               value_or_nan(low.at(i)),
+                               close.at(i).get<double>(),
+                               volume.at(i).is_null() ? 0 : volume.at(i).get<long long>());
             }
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error parsing daily data: " << e.what() << std::endl;
+        std::cerr << "Error parsing " << interval << " data for " << ticker << ": " << e.what() << std::endl;
         curl_easy_cleanup(curl);
         return false;
     }
-    
+
     curl_easy_cleanup(curl);
     return true;
 }
 
-// Function 3: Get only open/close for last 30 days
-bool fetch_open_close_data(const std::string& ticker) {
-    CURL* curl = curl_easy_init();
-    if (!curl) return false;
+// Aggregate finer bars into daily or weekly bars in the exchange time zone:
+// open=first, high=max, low=min, close=last, volume=sum. Each output bar is
+// stamped with the timestamp of its first input bar. Pre/post-market bars are
+// dropped unless include_pre_post is set.
+Bars resample_bars(const Bars& bars, const Session& session, Resolution resolution, bool include_pre_post) {
+    const size_t n = bars.size();
+    const long SKIP = LONG_MIN;
 
-    std::string readBuffer;
-    long period2 = std::time(nullptr);
-    long period1 = get_timestamp(30);
+    // Pass 1: bucket key per bar (local day or Monday-based local week)
+    std::vector<long> key(n);
+    for (size_t i = 0; i < n; ++i) {
+        long ts = bars.timestamp[i];
+        if (!include_pre_post && !in_regular_session(session, ts)) {
+            key[i] = SKIP;
+            continue;
+        }
+        long day = local_day(session, ts);
+        key[i] = resolution == Resolution::Daily ? day : floor_div(day + 3, 7);  // 1970-01-01 was a Thursday
+    }
 
-    std::string url = "https://query1.finance.yahoo.com/v8/finance/chart/" + 
-                     ticker + "?period1=" + std::to_string(period1) + 
-                     "&period2=" + std::to_string(period2) + 
-                     "&interval=1d";
+    // Pass 2: fold consecutive bars sharing a key; fmax/fmin skip missing (NaN) values
+    Bars out;
+    out.reserve(n / 4 + 1);
+    long current = SKIP;
+    for (size_t i = 0; i < n; ++i) {
+        if (key[i] == SKIP) continue;
+        if (key[i] != current) {
+            current = key[i];
+            out.push_back(bars.timestamp[i], bars.open[i], bars.high[i], bars.low[i], bars.close[i], bars.volume[i]);
+            continue;
+        }
+        size_t b = out.size() - 1;
+        if (std::isnan(out.open[b])) out.open[b] = bars.open[i];
+        out.high[b] = std::fmax(out.high[b], bars.high[i]);
+        out.low[b] = std::fmin(out.low[b], bars.low[i]);
+        out.close[b] = bars.close[i];
+        out.volume[b] += bars.volume[i];
+    }
+    return out;
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0");
+// Append derived bars for local days after the last downloaded one
+void merge_bars(Bars& into, const Bars& derived, const Session& session) {
+    long last_day = into.size() ? local_day(session, into.timestamp.back()) : LONG_MIN;
+    for (size_t i = 0; i < derived.size(); ++i) {
+        if (local_day(session, derived.timestamp[i]) <= last_day) continue;
+        into.push_back(derived.timestamp[i], derived.open[i], derived.high[i],
+                       derived.low[i], derived.close[i], derived.volume[i]);
+    }
+}
 
-    CURLcode res = curl_easy_perform(curl);
-    if (res != CURLE_OK) {
-        std::cerr << "Curl failed: " << curl_easy_strerror(res) << std::endl;
-        curl_easy_cleanup(curl);
-        return false;
+static void write_ohlcv(CsvWriter& csv, const Bars& bars, size_t i) {
+    csv.sep().number(bars.open[i])
+       .sep().number(bars.high[i])
+       .sep().number(bars.low[i])
+       .sep().number(bars.close[i])
+       .sep().number(bars.volume[i])
+       .end_row();
+}
+
+// Function 1: Print hourly data for last 7 days
+void print_hourly_data(CsvWriter& csv, const std::string& ticker, const Bars& bars, const Session& session) {
+    csv.text("\nHOURLY DATA for ").text(ticker).text(" (Last 7 days)\n");
+    csv.text("DateTime,Open,High,Low,Close,Volume\n");
+
+    char date[19];
+    for (size_t i = 0; i < bars.size(); ++i) {
+        csv.text(date, format_iso_datetime(bars.timestamp[i], utc_offset(session, bars.timestamp[i]), date));
+        write_ohlcv(csv, bars, i);
     }
+}
 
-    try {
-        json j = json::parse(readBuffer);
-        auto data = j["chart"]["result"][0];
-        
-        std::cout << "\nOPEN/CLOSE DATA for " << ticker << " (Last 30 days)\n";
-        std::cout << "Date,Open,Close\n";
-        
-        auto timestamps = data["timestamp"];
-        auto quotes = data["indicators"]["quote"][0];
-        
-        for (size_t i = 0; i < timestamps.size(); ++i) {
-            if (!quotes["close"][i].is_null() && !quotes["open"][i].is_null()) {
-                std::cout << format_timestamp(timestamps[i]).substr(0, 10) << ","
-                         << quotes["open"][i] << ","
-                         << quotes["close"][i] << std::endl;
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing open/close data: " << e.what() << std::endl;
-        curl_easy_cleanup(curl);
-        return false;
+// Function 2: Print daily data for last 30 days
+void print_daily_data(CsvWriter& csv, const std::string& ticker, const Bars& bars, const Session& session) {
+    csv.text("\nDAILY DATA for ").text(ticker).text(" (Last 30 days)\n");
+    csv.text("Date,Open,High,Low,Close,Volume\n");
+
+    char date[10];
+    for (size_t i = 0; i < bars.size(); ++i) {
+        csv.text(date, format_iso_date(local_day(session, bars.timestamp[i]), date));
+        write_ohlcv(csv, bars, i);
     }
-    
-    curl_easy_cleanup(curl);
-    return true;
 }
 
-int main() {
-    curl_global_init(CURL_GLOBAL_ALL);
+// Function 3: Print only open/close for last 30 days
+void print_open_close_data(CsvWriter& csv, const std::string& ticker, const Bars& bars, const Session& session) {
+    csv.text("\nOPEN/CLOSE DATA for ").text(ticker).text(" (Last 30 days)\n");
+    csv.text("Date,Open,Close\n");
 
-    for (const auto& ticker : TICKERS) {
-        std::cout << "\n=== Processing " << ticker << " ===\n";
-        fetch_hourly_data(ticker);
-        fetch_daily_data(ticker);
-        fetch_open_close_data(ticker);
-        //std::this_thread::sleep_for(std::chrono::seconds(1));
+    char date[10];
+    for (size_t i = 0; i < bars.size(); ++i) {
+        if (std::isnan(bars.open[i])) continue;
+        csv.text(date, format_iso_date(local_day(session, bars.timestamp[i]), date));
+        csv.sep().number(bars.open[i]).sep().number(bars.close[i]).end_row();
     }
+}
+
+// Function 4: Print weekly data for last 30 days
+void print_weekly_data(CsvWriter& csv, const std::string& ticker, const Bars& bars, const Session& session) {
+    csv.text("\nWEEKLY DATA for ").text(ticker).text(" (Last 30 days)\n");
+    csv.text("Week,Open,High,Low,Close,Volume\n");
+
+    char date[10];
+    for (size_t i = 0; i < bars.size(); ++i) {
+        csv.text(date, format_iso_date(local_day(session, bars.timestamp[i]), date));
+        write_ohlcv(csv, bars, i);
+    }
+}
+
+// Dump bars as a binary columnar file (see ColumnFileWriter for the layout)
+bool export_bars(const std::string& path, const Bars& bars) {
+    ColumnFileWriter writer(bars.size());
+    writer.add_column("timestamp", bars.timestamp);
+    writer.add_column("open", bars.open);
+    writer.add_column("high", bars.high);
+    writer.add_column("low", bars.low);
+    writer.add_column("close", bars.close);
+    writer.add_column("volume", bars.volume);
+    return writer.write(path);
+}
 
+// Usage: get_ts [export_dir]
+// With export_dir, each ticker's hourly and daily bars are also written to
+// <export_dir>/<ticker>_1h.bars and <export_dir>/<ticker>_1d.bars.
+int main(int argc, char** argv) {
+    std::string export_dir = argc > 1 ? argv[1] : "";
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    {
+        // Declared first so the exporter drains into it before it is flushed
+        CsvWriter csv(stdout);
+        BackgroundExporter exporter;
+
+        for (const auto& ticker : TICKERS) {
+            // Only the finest interval is fetched for the recent week; daily bars
+            // for that week are resampled locally from the hourly ones.
+            long now = std::time(nullptr);
+            long split = get_timestamp(7);
+
+            Bars hourly;
+            Session session;
+            bool have_hourly = fetch_chart(ticker, split, now, "1h", true, hourly, session) && hourly.size() > 0;
+
+            // Without regular-session hourly bars to resample (e.g. no intraday
+            // data for the instrument), download daily bars for the whole range
+            Bars recent = have_hourly ? resample_bars(hourly, session, Resolution::Daily, false) : Bars();
+            bool derive_recent = recent.size() > 0;
+
+            Bars daily;
+            Session daily_session;
+            fetch_chart(ticker, get_timestamp(30), derive_recent ? split : now, "1d", false, daily, daily_session);
+            if (derive_recent) {
+                merge_bars(daily, recent, session);
+            }
+            if (!have_hourly) {
+                session = daily_session;
+            }
+
+            // Formatting and file I/O run on the exporter thread while the next ticker is fetched
+            exporter.submit([&csv, ticker, export_dir, have_hourly,
+                             hourly = std::move(hourly), daily = std::move(daily), session = std::move(session)]() {
+                csv.text("\n=== Processing ").text(ticker).text(" ===\n");
+                if (have_hourly) {
+                    print_hourly_data(csv, ticker, hourly, session);
+                }
+                print_daily_data(csv, ticker, daily, session);
+                print_open_close_data(csv, ticker, daily, session);
+                print_weekly_data(csv, ticker, resample_bars(daily, session, Resolution::Weekly, true), session);
+
+                if (!export_dir.empty()) {
+                    if (have_hourly) {
+                        export_bars(export_dir + "/" + ticker + "_1h.bars", hourly);
+                    }
+                    export_bars(export_dir + "/" + ticker + "_1d.bars", daily);
+                }
+            });
+            //std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
     curl_global_cleanup();
     return 0;
 }
@@ -12,6 +12,7 @@
 #include <sstream>
 #include <cmath>
 #include <map>
+#include "time_utils.hpp"
 
 using json = nlohmann::json;
 
@@ -24,32 +25,35 @@ class Position {
 public:
     std::string ticker;
     std::string purchase_date;
+    long purchase_day;         // epoch day of purchase_date
     double purchase_price;
     double volume;
     
-    Position(std::string t, std::string date, double vol)
-        : ticker(t), purchase_date(date), purchase_price(0.0), volume(vol) {}
+    Position(std::string t, std::string date, long day, double vol)
+        : ticker(t), purchase_date(date), purchase_day(day), purchase_price(0.0), volume(vol) {}
 };
 
 class Portfolio {
 private:
     std::vector<Position> positions;
     std::map<std::string, std::vector<std::pair<long, double>>> historical_prices;
+    std::map<std::string, long> utc_offsets;   // exchange's current UTC offset per ticker
     
-    long convert_date_to_timestamp(const std::string& date) {
-        std::tm tm = {};
-        std::stringstream ss(date);
-        ss >> std::get_time(&tm, "%Y-%m-%d");
-        auto time = std::mktime(&tm);
-        return time;
+    // Midnight of the given day in the ticker's exchange time zone (UTC until its chart is fetched).
+    // Only the current offset is known, so across a DST change this can be an hour off; that
+    // never moves midnight past a session open, so the matched daily bar is unaffected.
+    long convert_day_to_timestamp(const std::string& ticker, long epoch_day) {
+        auto it = utc_offsets.find(ticker);
+        long offset = it != utc_offsets.end() ? it->second : 0;
+        return epoch_day * SECONDS_PER_DAY - offset;
     }
     
-    bool fetch_historical_data(const std::string& ticker, const std::string& start_date) {
+    bool fetch_historical_data(const std::string& ticker, long start_day) {
         CURL* curl = curl_easy_init();
         if (!curl) return false;
 
         long period2 = std::time(nullptr);
-        long period1 = convert_date_to_timestamp(start_date);
+        long period1 = convert_day_to_timestamp(ticker, start_day);
 
         std::string url = "https://query1.finance.yahoo.com/v8/finance/chart/" + 
                          ticker + "?period1=" + std::to_string(period1) + 
@@ -71,9 +75,14 @@ private:
 
         try {
             json j = json::parse(readBuffer);
+            auto meta = j["chart"]["result"][0]["meta"];
             auto timestamps = j["chart"]["result"][0]["timestamp"];
             auto closes = j["chart"]["result"][0]["indicators"]["quote"][0]["close"];
             
+            if (meta.contains("gmtoffset")) {
+                utc_offsets[ticker] = meta["gmtoffset"];
+            }
+            
             std::vector<std::pair<long, double>> price_data;
             for (size_t i = 0; i < timestamps.size(); ++i) {
                 if (!closes[i].is_null()) {
@@ -105,7 +114,12 @@ private:
 
 public:
     void add_position(const std::string& ticker, const std::string& date, double volume) {
-        positions.emplace_back(ticker, date, volume);
+        long day;
+        if (!parse_iso_date(date, day)) {
+            std::cerr << "Invalid purchase date for " << ticker << ": " << date << std::endl;
+            return;
+        }
+        positions.emplace_back(ticker, date, day, volume);
     }
     
     void generate_report() {
@@ -121,8 +135,8 @@ public:
       
       // First fetch all historical data
       for (auto& pos : positions) {
-          fetch_historical_data(pos.ticker, pos.purchase_date);
-          long purchase_ts = convert_date_to_timestamp(pos.purchase_date);
+          fetch_historical_data(pos.ticker, pos.purchase_day);
+          long purchase_ts = convert_day_to_timestamp(pos.ticker, pos.purchase_day);
           pos.purchase_price = get_price_on_date(pos.ticker, purchase_ts);
       }
       
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Thread-safe date/time helpers. Dates are carried as epoch days (days since
+// 1970-01-01) and instants as UTC seconds plus an explicit UTC offset, so
+// nothing here touches the process time zone or localtime's shared state.
+
+static const long SECONDS_PER_DAY = 86400;
+
+// Range of epoch days printable as "YYYY-MM-DD": 0000-01-01 to 9999-12-31
+static const long MIN_ISO_DAY = -719528;
+static const long MAX_ISO_DAY = 2932896;
+
+static const int DAYS_BEFORE_MONTH[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+static const char DIGIT_PAIRS[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+inline long floor_div(long a, long b) {
+    long q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+inline bool is_leap_year(int y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+inline int days_in_month(int y, int m) {
+    static const int DAYS[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return m == 2 && is_leap_year(y) ? 29 : DAYS[m - 1];
+}
+
+// Epoch day of a proleptic Gregorian date (year >= 1)
+inline long days_from_civil(int y, int m, int d) {
+    long y1 = y - 1;
+    long days = 365 * y1 + y1 / 4 - y1 / 100 + y1 / 400;
+    days += DAYS_BEFORE_MONTH[m - 1] + (m > 2 && is_leap_year(y) ? 1 : 0) + d - 1;
+    return days - 719162;  // 0001-01-01 to 1970-01-01
+}
+
+inline void civil_from_days(long z, int& y, int& m, int& d) {
+    z += 719468;
+    long era = floor_div(z, 146097);
+    long doe = z - era * 146097;
+    long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long mp = (5 * doy + 2) / 153;
+    d = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    y = static_cast<int>(yoe + era * 400 + (m <= 2 ? 1 : 0));
+}
+
+// Parse "YYYY-M-D" (zero padding optional) into an epoch day
+inline bool parse_iso_date(const std::string& s, long& epoch_day) {
+    int parts[3] = {0, 0, 0};
+    size_t i = 0;
+    for (int p = 0; p < 3; ++p) {
+        size_t start = i;
+        while (i < s.size() && s[i] >= '0' && s[i] <= '9' && i - start < 4) {
+            parts[p] = parts[p] * 10 + (s[i] - '0');
+            ++i;
+        }
+        if (i == start) return false;
+        if (p < 2) {
+            if (i >= s.size() || s[i] != '-') return false;
+            ++i;
+        }
+    }
+    if (i != s.size()) return false;
+
+    int y = parts[0], m = parts[1], d = parts[2];
+    if (y < 1 || m < 1 || m > 12 || d < 1 || d > days_in_month(y, m)) return false;
+    epoch_day = days_from_civil(y, m, d);
+    return true;
+}
+
+// Write "YYYY-MM-DD" into buf (no terminator); returns the 10 characters written.
+// Days outside years 0000-9999 are clamped to that range. Consecutive calls
+// for the same day reuse the last result.
+inline size_t format_iso_date(long epoch_day, char* buf) {
+    thread_local long cached_day = LONG_MIN;  // never a clamped day
+    thread_local char cached[10];
+
+    epoch_day = std::min(std::max(epoch_day, MIN_ISO_DAY), MAX_ISO_DAY);
+    if (epoch_day != cached_day) {
+        int y, m, d;
+        civil_from_days(epoch_day, y, m, d);
+        std::memcpy(cached, DIGIT_PAIRS + 2 * ((y / 100) % 100), 2);
+        std::memcpy(cached + 2, DIGIT_PAIRS + 2 * (y % 100), 2);
+        cached[4] = '-';
+        std::memcpy(cached + 5, DIGIT_PAIRS + 2 * m, 2);
+        cached[7] = '-';
+        std::memcpy(cached + 8, DIGIT_PAIRS + 2 * d, 2);
+        cached_day = epoch_day;
+    }
+    std::memcpy(buf, cached, 10);
+    return 10;
+}
+
+// Write "YYYY-MM-DD HH:MM:SS" for ts shifted by utc_offset (less than a day);
+// returns the 19 characters written. Instants outside years 0000-9999 are clamped.
+inline size_t format_iso_datetime(long ts, long utc_offset, char* buf) {
+    const long first = MIN_ISO_DAY * SECONDS_PER_DAY;
+    const long last = (MAX_ISO_DAY + 1) * SECONDS_PER_DAY - 1;
+    long local = std::min(std::max(ts, first - SECONDS_PER_DAY), last + SECONDS_PER_DAY) + utc_offset;
+    local = std::min(std::max(local, first), last);
+    long day = floor_div(local, SECONDS_PER_DAY);
+    long sod = local - day * SECONDS_PER_DAY;
+
+    format_iso_date(day, buf);
+    buf[10] = ' ';
+    std::memcpy(buf + 11, DIGIT_PAIRS + 2 * (sod / 3600), 2);
+    buf[13] = ':';
+    std::memcpy(buf + 14, DIGIT_PAIRS + 2 * (sod / 60 % 60), 2);
+    buf[16] = ':';
+    std::memcpy(buf + 17, DIGIT_PAIRS + 2 * (sod % 60), 2);
+    return 19;
+}